@@ -145,8 +145,27 @@ namespace alembic {
                 try_emit<I+1>(values, flow);
             }
         }
+
+        void snapshot(checkpoint_sink &sink) const requires checkpoint_value<Y> {
+            sink.write(i);
+            sink.write(values);
+        }
+
+        void restore(checkpoint_source &source) requires checkpoint_value<Y> {
+            auto staged_i = source.read<size_t>();
+            if (staged_i >= N) {
+                throw checkpoint_error("collect_n index out of range");
+            }
+            auto staged_values = source.read<std::array<Y, N>>();
+            i = staged_i;
+            values = staged_values;
+        }
     };
 
+    /**
+     * Passes each element to a stateful reducer, which returns an `std::optional` of the value to emit to the next attractor.
+     * The reducer is checkpointed if it has `snapshot` and `restore` members of its own; a lambda's captures cannot be.
+     */
     template <class Reducer> struct reduce {
         static constexpr auto attractor_name = "reduce";
 
@@ -159,6 +178,14 @@ namespace alembic {
                 try_emit<I+1>(std::move(opt.value()), flow);
             }
         }
+
+        void snapshot(checkpoint_sink &sink) const requires requires { reducer.snapshot(sink); } {
+            reducer.snapshot(sink);
+        }
+
+        void restore(checkpoint_source &source) requires requires { reducer.restore(source); } {
+            reducer.restore(source);
+        }
     };
 
     template <class T> concept iterable_type = requires (T t) {
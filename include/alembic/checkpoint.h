@@ -0,0 +1,130 @@
+/*
+ * Copyright 2021 Kioshi Morosin <hex@hex.lc>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ALEMBIC_CHECKPOINT_H
+#define ALEMBIC_CHECKPOINT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <span>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+namespace alembic {
+
+    /**
+     * Thrown when a checkpoint does not match the shape of the flow or flux it is being restored into.
+     */
+    struct checkpoint_error: std::runtime_error {
+        using std::runtime_error::runtime_error;
+    };
+
+    /**
+     * Types whose bytes remain meaningful in another process. Pointers are trivially copyable but would dangle after a
+     * restart, so they are excluded; a struct that holds pointers cannot be detected and must not be checkpointed by value.
+     */
+    template <class T> concept checkpoint_value = std::is_trivially_copyable_v<T> && !std::is_pointer_v<T> && !std::is_member_pointer_v<T>;
+
+    /**
+     * Accumulates the binary state of a flow or flux. Attractors write their state with `write`, and the result may be
+     * persisted with `write_checkpoint` from checkpoint_file.h.
+     */
+    class checkpoint_sink {
+        std::vector<std::byte> buffer;
+
+    public:
+        void write_bytes(const void *data, size_t size) {
+            auto bytes = static_cast<const std::byte *>(data);
+            buffer.insert(buffer.end(), bytes, bytes + size);
+        }
+
+        template <class T> requires std::is_trivially_copyable_v<T> void write(const T &t) {
+            write_bytes(&t, sizeof(T));
+        }
+
+        /**
+         * Write a length-prefixed record. The length is back-patched once `body` returns, so that a reader can verify that
+         * exactly the bytes that were written are consumed on restore.
+         * @param body a functor that writes the record contents to this sink
+         */
+        template <class Body> void record(Body &&body) {
+            size_t at = buffer.size();
+            write(uint64_t(0));
+            std::invoke(std::forward<Body>(body), *this);
+            uint64_t length = buffer.size() - at - sizeof(uint64_t);
+            std::memcpy(buffer.data() + at, &length, sizeof(uint64_t));
+        }
+
+        [[nodiscard]] std::span<const std::byte> data() const {
+            return buffer;
+        }
+    };
+
+    /**
+     * Reads back the binary state written by a `checkpoint_sink`. The source does not own its bytes; they must outlive it.
+     */
+    class checkpoint_source {
+        std::span<const std::byte> bytes;
+        size_t position = 0;
+
+    public:
+        explicit checkpoint_source(std::span<const std::byte> _bytes): bytes(_bytes) { }
+
+        void read_bytes(void *data, size_t size) {
+            if (size > bytes.size() - position) {
+                throw checkpoint_error("checkpoint truncated");
+            }
+            std::memcpy(data, bytes.data() + position, size);
+            position += size;
+        }
+
+        template <class T> requires std::is_trivially_copyable_v<T> void read(T &t) {
+            read_bytes(&t, sizeof(T));
+        }
+
+        template <class T> requires std::is_trivially_copyable_v<T> T read() {
+            T t;
+            read(t);
+            return t;
+        }
+
+        /**
+         * Read a record written by `checkpoint_sink::record`.
+         * @param body a functor that reads the record contents from this source
+         * @throws checkpoint_error if `body` does not consume the record exactly
+         */
+        template <class Body> void record(Body &&body) {
+            auto length = read<uint64_t>();
+            if (length > bytes.size() - position) {
+                throw checkpoint_error("checkpoint truncated");
+            }
+            size_t end = position + length;
+            std::invoke(std::forward<Body>(body), *this);
+            if (position != end) {
+                throw checkpoint_error("checkpoint record size mismatch");
+            }
+        }
+
+        [[nodiscard]] bool exhausted() const {
+            return position == bytes.size();
+        }
+    };
+}
+
+#endif //ALEMBIC_CHECKPOINT_H
@@ -0,0 +1,147 @@
+/*
+ * Copyright 2021 Kioshi Morosin <hex@hex.lc>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ALEMBIC_CHECKPOINT_FILE_H
+#define ALEMBIC_CHECKPOINT_FILE_H
+
+#include <cerrno>
+#include <string>
+#include <system_error>
+#include "checkpoint.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace alembic {
+
+    namespace detail {
+        constexpr uint32_t checkpoint_magic = 0x424d4c41; // "ALMB"
+        constexpr uint32_t checkpoint_version = 1;
+
+        struct file_descriptor {
+            int fd;
+
+            file_descriptor(const std::string &path, int flags, mode_t mode = 0): fd(::open(path.c_str(), flags, mode)) {
+                if (fd < 0) {
+                    throw std::system_error(errno, std::generic_category(), path);
+                }
+            }
+
+            file_descriptor(const file_descriptor &) = delete;
+
+            ~file_descriptor() {
+                ::close(fd);
+            }
+        };
+
+        inline void write_mapped(const std::string &path, std::span<const std::byte> payload) {
+            const uint32_t header[] = { checkpoint_magic, checkpoint_version };
+            size_t size = sizeof(header) + payload.size();
+
+            file_descriptor file(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+            if (::ftruncate(file.fd, off_t(size)) != 0) {
+                throw std::system_error(errno, std::generic_category(), path);
+            }
+
+            void *map = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, file.fd, 0);
+            if (map == MAP_FAILED) {
+                throw std::system_error(errno, std::generic_category(), path);
+            }
+            std::memcpy(map, header, sizeof(header));
+            std::memcpy(static_cast<std::byte *>(map) + sizeof(header), payload.data(), payload.size());
+            int synced = ::msync(map, size, MS_SYNC);
+            int err = errno;
+            ::munmap(map, size);
+            if (synced != 0) {
+                throw std::system_error(err, std::generic_category(), path);
+            }
+        }
+    }
+
+    /**
+     * Write the contents of a sink through a shared memory mapping to a temporary file beside `path`, then rename it over
+     * `path`. A crash part way through leaves any previous checkpoint at `path` intact.
+     * @param path the file to write
+     * @param sink the checkpoint to persist
+     */
+    inline void write_checkpoint(const std::string &path, const checkpoint_sink &sink) {
+        auto temporary = path + ".tmp";
+        try {
+            detail::write_mapped(temporary, sink.data());
+        } catch (...) {
+            ::unlink(temporary.c_str());
+            throw;
+        }
+        if (::rename(temporary.c_str(), path.c_str()) != 0) {
+            int err = errno;
+            ::unlink(temporary.c_str());
+            throw std::system_error(err, std::generic_category(), path);
+        }
+    }
+
+    /**
+     * A read-only memory mapping of a checkpoint file. Restoring reads directly from the mapping, so the file is never
+     * copied into the process.
+     */
+    class mapped_checkpoint {
+        void *map = MAP_FAILED;
+        size_t size = 0;
+
+    public:
+        explicit mapped_checkpoint(const std::string &path) {
+            detail::file_descriptor file(path, O_RDONLY);
+            struct stat st { };
+            if (::fstat(file.fd, &st) != 0) {
+                throw std::system_error(errno, std::generic_category(), path);
+            }
+            size = size_t(st.st_size);
+
+            uint32_t header[2];
+            if (size < sizeof(header)) {
+                throw checkpoint_error("not a checkpoint: " + path);
+            }
+
+            map = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, file.fd, 0);
+            if (map == MAP_FAILED) {
+                throw std::system_error(errno, std::generic_category(), path);
+            }
+
+            std::memcpy(header, map, sizeof(header));
+            if (header[0] != detail::checkpoint_magic || header[1] != detail::checkpoint_version) {
+                ::munmap(map, size);
+                throw checkpoint_error("not a checkpoint: " + path);
+            }
+        }
+
+        mapped_checkpoint(const mapped_checkpoint &) = delete;
+        mapped_checkpoint &operator=(const mapped_checkpoint &) = delete;
+
+        ~mapped_checkpoint() {
+            ::munmap(map, size);
+        }
+
+        /**
+         * @return a source over the checkpoint payload, valid for the lifetime of this mapping
+         */
+        [[nodiscard]] checkpoint_source source() const {
+            return checkpoint_source({ static_cast<const std::byte *>(map) + 2 * sizeof(uint32_t), size - 2 * sizeof(uint32_t) });
+        }
+    };
+}
+
+#endif //ALEMBIC_CHECKPOINT_FILE_H
@@ -21,6 +21,12 @@
 #include <type_traits>
 #include <concepts>
 #include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <tuple>
+#include <typeinfo>
+#include "checkpoint.h"
 
 namespace alembic {
 
@@ -35,6 +41,64 @@ namespace alembic {
         { attractor_traits<A>::attractor_name } -> std::convertible_to<const char *>;
     };
 
+    /**
+     * Attractors that carry state between elements may opt in to checkpointing by satisfying this concept, either with
+     * `snapshot` and `restore` members or with static functions of the same name in a specialization of `attractor_traits`.
+     */
+    template <class A> concept stateful_attractor = requires (A &a, const A &c, checkpoint_sink &sink, checkpoint_source &source) {
+        c.snapshot(sink);
+        a.restore(source);
+    } || requires (A &a, const A &c, checkpoint_sink &sink, checkpoint_source &source) {
+        attractor_traits<A>::snapshot(c, sink);
+        attractor_traits<A>::restore(a, source);
+    };
+
+    /**
+     * A cheap identity for an attractor type, hashed from its name, its type and its size. It is written ahead of each
+     * attractor's state so that state cannot be restored into a different attractor that happens to be the same size.
+     */
+    template <attractor_type A> uint64_t attractor_fingerprint() {
+        const char *name;
+        if constexpr (requires { A::attractor_name; }) {
+            name = A::attractor_name;
+        } else {
+            name = attractor_traits<A>::attractor_name;
+        }
+
+        uint64_t hash = 0xcbf29ce484222325; // FNV-1a
+        auto mix = [&hash](const char *s){
+            for (; *s; s++) {
+                hash = (hash ^ uint8_t(*s)) * 0x100000001b3;
+            }
+        };
+        mix(name);
+        mix(typeid(A).name());
+        return (hash ^ sizeof(A)) * 0x100000001b3;
+    }
+
+    template <stateful_attractor A> void snapshot_attractor(const A &a, checkpoint_sink &sink) {
+        sink.write(attractor_fingerprint<A>());
+        if constexpr (requires { a.snapshot(sink); }) {
+            a.snapshot(sink);
+        } else {
+            attractor_traits<A>::snapshot(a, sink);
+        }
+    }
+
+    /**
+     * @throws checkpoint_error if the state was written by a different attractor type
+     */
+    template <stateful_attractor A> void restore_attractor(A &a, checkpoint_source &source) {
+        if (source.read<uint64_t>() != attractor_fingerprint<A>()) {
+            throw checkpoint_error(std::string("checkpoint record is not for this ") + typeid(A).name());
+        }
+        if constexpr (requires { a.restore(source); }) {
+            a.restore(source);
+        } else {
+            attractor_traits<A>::restore(a, source);
+        }
+    }
+
     template <attractor_type A, class X, class F, size_t I, class = void> struct attractor_takes: std::false_type { };
     template <attractor_type A, class X, class F, size_t I> struct attractor_takes<A, X, F, I, std::enable_if_t<std::is_invocable_v<decltype(&A::template emit<I, F>), A&, X&&, F*>>>: std::true_type { };
     template <attractor_type A, class X, class F, size_t I> struct attractor_takes<A, X, F, I, std::enable_if_t<std::is_invocable_v<decltype(&A::template emit<I, F, X>), A&, X&&, F*>>>: std::true_type { };
@@ -93,6 +157,40 @@ namespace alembic {
         template <size_t I> constexpr auto attractor() const {
             return std::get<I>(attractors);
         }
+
+        /**
+         * Write the state of each stateful attractor in the flow to a checkpoint. Stateless attractors are skipped.
+         * @param sink the checkpoint to write to
+         */
+        void snapshot(checkpoint_sink &sink) const {
+            std::apply([&sink](const A &...a){
+                ([&]{
+                    if constexpr (stateful_attractor<A>) {
+                        sink.record([&a](checkpoint_sink &s){ snapshot_attractor(a, s); });
+                    }
+                }(), ...);
+            }, attractors);
+        }
+
+        /**
+         * Restore the state of each stateful attractor in the flow from a checkpoint written by `snapshot`.
+         * @param source the checkpoint to read from
+         * @throws checkpoint_error if the checkpoint does not match the flow or has bytes left over
+         * @return a new flow, leaving this one unchanged
+         */
+        flow<A...> restored(checkpoint_source &source) const {
+            return std::apply([&source](A ...a){
+                ([&]{
+                    if constexpr (stateful_attractor<A>) {
+                        source.record([&a](checkpoint_source &s){ restore_attractor(a, s); });
+                    }
+                }(), ...);
+                if (!source.exhausted()) {
+                    throw checkpoint_error("checkpoint has trailing data");
+                }
+                return flow<A...>(std::move(a)...);
+            }, attractors);
+        }
     };
 
     /**
@@ -109,28 +207,58 @@ namespace alembic {
 
     using removal_tag_t = void *;
 
+    /**
+     * The callable held in the emitter of a `bound_flow`. The flow is immutable and shared between copies, but the head
+     * attractor carries state and is copied along with the emitter, so copies of a bound flow evolve independently.
+     */
+    template <class X, size_t I, class F> struct bound_head {
+        using attractor_t = std::tuple_element_t<I, typename F::flow_types>;
+
+        std::shared_ptr<const F> flow;
+        std::optional<attractor_t> head;
+
+        void operator()(X x) {
+            head->template emit<I, F, X>(std::forward<X>(x), flow.get());
+        }
+    };
+
     template <class X> struct bound_flow {
         std::function<void(X)> emitter;
         removal_tag_t remove_tag;
+        /// Null unless the head attractor is a `stateful_attractor`. Both reach the head attractor held in `emitter`;
+        /// `restore_head` reads into a staged copy and returns a function that commits it, so a failed restore can be abandoned.
+        void (*snapshot_head)(const std::function<void(X)> &, checkpoint_sink &) = nullptr;
+        std::function<void()> (*restore_head)(std::function<void(X)> &, checkpoint_source &) = nullptr;
     };
 
     /**
      * Bind the emit function at the head of the given flow. This can be used to pass around a function pointer instead
-     * of the templated `flow`.
+     * of the templated `flow`. The bound function keeps its own copy of the flow, so the argument need not outlive it.
+     * @tparam X the element type
      * @tparam A attractor types
      * @param flow the flow to bind
      * @return a function callable with the single argument corresponding to the `x` parameter of the flow's first attractor
      */
     template <class X, attractor_type ...A> constexpr bound_flow<X> bind_flow(flow<A...> &flow, removal_tag_t remove_tag = nullptr) {
         constexpr size_t index = find_next<0, ::alembic::flow<A...>, X>::value;
-        using Att = std::tuple_element_t<index, typename ::alembic::flow<A...>::flow_types>;
-        return {
-                std::bind(&Att::template emit<index, ::alembic::flow<A...>, X>,
-                          flow.template attractor<index>(),
-                          std::placeholders::_1,
-                          &flow),
+        using head_t = bound_head<X, index, ::alembic::flow<A...>>;
+        using Att = typename head_t::attractor_t;
+        bound_flow<X> bound {
+                head_t { std::make_shared<const ::alembic::flow<A...>>(flow), flow.template attractor<index>() },
                 remove_tag
         };
+        if constexpr (stateful_attractor<Att>) {
+            bound.snapshot_head = [](const std::function<void(X)> &emitter, checkpoint_sink &sink){
+                snapshot_attractor(*emitter.template target<head_t>()->head, sink);
+            };
+            bound.restore_head = [](std::function<void(X)> &emitter, checkpoint_source &source) -> std::function<void()> {
+                auto target = emitter.template target<head_t>();
+                auto staged = std::make_shared<Att>(*target->head);
+                restore_attractor(*staged, source);
+                return [target, staged]{ target->head.emplace(std::move(*staged)); };
+            };
+        }
+        return bound;
     }
 
     template <size_t I, class F, class X> constexpr void try_emit(X &&x, F *flow) {
@@ -19,10 +19,17 @@
 
 #include <exception>
 #include <tuple>
+#include <vector>
 #include "attractors_builtin.h"
 
 namespace alembic {
 
+    /**
+     * The first of `T, U...` that `From` is convertible to; ill-formed if there is none.
+     */
+    template <class From, class T, class ...U> struct first_type_convertible: std::conditional_t<std::is_convertible_v<From, T>, std::type_identity<T>, first_type_convertible<From, U...>> { };
+    template <class From, class T> struct first_type_convertible<From, T>: std::enable_if_t<std::is_convertible_v<From, T>, std::type_identity<T>> { };
+
     /**
      * Represents the point at which elements might be emitted to a flow.
      * @tparam X the type of element being admitted to the head of the flow
@@ -31,8 +38,29 @@ namespace alembic {
         std::tuple<burst<X>...> main_burst;
         burst<const std::exception_ptr> exception_burst;
 
-        template <class From, class T, class ...U> struct first_type_convertible: std::conditional_t<std::is_convertible_v<From, T>, std::type_identity<T>, first_type_convertible<From, U...>> { };
-        template <class From, class T> struct first_type_convertible<From, T>: std::enable_if_t<std::is_convertible_v<From, T>, std::type_identity<T>> { };
+        template <class Y> static void snapshot_burst(const burst<Y> &b, checkpoint_sink &sink) {
+            sink.write(uint64_t(b.subflows.size()));
+            for (const auto &subflow : b.subflows) {
+                sink.write(uint8_t(subflow.snapshot_head != nullptr));
+                if (subflow.snapshot_head) {
+                    sink.record([&subflow](checkpoint_sink &s){ subflow.snapshot_head(subflow.emitter, s); });
+                }
+            }
+        }
+
+        template <class Y> static void restore_burst(burst<Y> &b, checkpoint_source &source, std::vector<std::function<void()>> &commits) {
+            if (source.read<uint64_t>() != b.subflows.size()) {
+                throw checkpoint_error("checkpoint does not match attached flows");
+            }
+            for (auto &subflow : b.subflows) {
+                if (bool(source.read<uint8_t>()) != (subflow.restore_head != nullptr)) {
+                    throw checkpoint_error("checkpoint does not match attached flows");
+                }
+                if (subflow.restore_head) {
+                    source.record([&](checkpoint_source &s){ commits.push_back(subflow.restore_head(subflow.emitter, s)); });
+                }
+            }
+        }
 
     public:
         /**
@@ -93,6 +121,39 @@ namespace alembic {
             return except(std::move(flow(attractor)), remove_tag);
         }
 
+        /**
+         * Write the state of every attached flow, including those on the exception handling chain, to a checkpoint. Only the
+         * head attractor of each flow outlives a single `emit`, so it is the only one whose state is recorded.
+         * @param sink the checkpoint to write to
+         * @return the same flux
+         */
+        const flux<X...> &snapshot(checkpoint_sink &sink) const {
+            (snapshot_burst(std::get<burst<X>>(main_burst), sink), ...);
+            snapshot_burst(exception_burst, sink);
+            return *this;
+        }
+
+        /**
+         * Restore the state of every attached flow from a checkpoint written by `snapshot`. The same flows must have been
+         * attached, in the same order, as when the checkpoint was taken. Nothing is changed unless the whole checkpoint is
+         * read successfully.
+         * @param source the checkpoint to read from
+         * @throws checkpoint_error if the checkpoint does not match the attached flows or has bytes left over
+         * @return the same flux
+         */
+        flux<X...> &restore(checkpoint_source &source) {
+            std::vector<std::function<void()>> commits;
+            (restore_burst(std::get<burst<X>>(main_burst), source, commits), ...);
+            restore_burst(exception_burst, source, commits);
+            if (!source.exhausted()) {
+                throw checkpoint_error("checkpoint has trailing data");
+            }
+            for (auto &commit : commits) {
+                commit();
+            }
+            return *this;
+        }
+
         /**
          * Detaches a flow from the flux.
          * @param remove_tag an identifier returned in a call to `attach`
@@ -109,7 +170,7 @@ namespace alembic {
          * @return the same flux
          */
         flux<X...> &detach_except(removal_tag_t &remove_tag) {
-            std::erase_if(exception_burst.subflows, [remove_tag]<class T>(bound_flow<T> f){ return remove_tag == f.remove.tag; });
+            std::erase_if(exception_burst.subflows, [remove_tag]<class T>(bound_flow<T> f){ return remove_tag == f.remove_tag; });
             return *this;
         }
     };
@@ -0,0 +1,217 @@
+/*
+ * Copyright 2021 Kioshi Morosin <hex@hex.lc>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ALEMBIC_PRIORITY_FLUX_H
+#define ALEMBIC_PRIORITY_FLUX_H
+
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <initializer_list>
+#include <variant>
+#include <vector>
+#include "flux.h"
+
+namespace alembic {
+
+    /**
+     * Queueing statistics for a single lane of a `priority_flux`. Waits are measured from `emit` until the element is
+     * handed to the attached flows.
+     */
+    struct lane_stats {
+        size_t served = 0;
+        size_t late = 0;
+        std::chrono::steady_clock::duration total_wait { };
+        std::chrono::steady_clock::duration max_wait { };
+    };
+
+    /**
+     * A flux whose elements are queued into priority lanes rather than emitted inline, and handed to the attached flows
+     * by `step` or `drain`. Lane 0 is the most urgent. Each element carries a deadline, by default its lane's latency
+     * budget after it was queued; once the head of any lane is past its deadline, the lane with the earliest such deadline
+     * is served before strict priority order resumes, so that lower lanes cannot starve. Not thread-safe.
+     * @tparam X the type of element being admitted to the head of the flow
+     */
+    template <class ...X> class priority_flux {
+        using clock = std::chrono::steady_clock;
+
+        struct pending {
+            std::variant<X...> element;
+            clock::time_point queued;
+            clock::time_point deadline;
+        };
+
+        struct lane {
+            clock::duration budget;
+            std::deque<pending> queue;
+            lane_stats stats;
+        };
+
+        flux<X...> inner;
+        std::vector<lane> lanes;
+
+    public:
+        /**
+         * @param budgets the latency budget of each lane, most urgent first
+         */
+        priority_flux(std::initializer_list<clock::duration> budgets): lanes(budgets.size()) {
+            // sized up front, since growing the vector would copy lanes holding move-only elements
+            auto budget = budgets.begin();
+            for (auto &l : lanes) {
+                l.budget = *budget++;
+            }
+        }
+
+        /**
+         * Queue an element on a lane with that lane's latency budget as its deadline. A budget too large to add to the
+         * current time, such as `duration::max()`, means the lane has no deadline.
+         * @param t the element to emit
+         * @param l the lane index
+         * @return the same flux
+         */
+        template <class T> priority_flux<X...> &emit(T &&t, size_t l = 0) {
+            auto now = clock::now();
+            auto budget = lanes.at(l).budget;
+            auto deadline = budget >= clock::time_point::max() - now ? clock::time_point::max() : now + budget;
+            return emit(std::forward<T>(t), l, deadline);
+        }
+
+        /**
+         * Queue an element on a lane with an explicit deadline. Deadlines are only inspected at the head of each lane.
+         * @param t the element to emit
+         * @param l the lane index
+         * @param deadline the time by which the element should be served
+         * @return the same flux
+         */
+        template <class T> priority_flux<X...> &emit(T &&t, size_t l, clock::time_point deadline) {
+            static_assert((std::is_convertible_v<T, X> || ...), "cannot emit type from flux");
+
+            using element_type_t = typename first_type_convertible<T, X...>::type;
+            lanes.at(l).queue.push_back({
+                std::variant<X...>(std::in_place_type<element_type_t>, std::forward<T>(t)),
+                clock::now(),
+                deadline
+            });
+            return *this;
+        }
+
+        /**
+         * Serve a single queued element: the overdue lane head with the earliest deadline if there is one, otherwise the
+         * head of the most urgent non-empty lane.
+         * @return false if every lane was empty
+         */
+        bool step() {
+            auto now = clock::now();
+            lane *urgent = nullptr;
+            lane *overdue = nullptr;
+            for (auto &l : lanes) {
+                if (l.queue.empty()) {
+                    continue;
+                }
+                if (!urgent) {
+                    urgent = &l;
+                }
+                if (l.queue.front().deadline <= now && (!overdue || l.queue.front().deadline < overdue->queue.front().deadline)) {
+                    overdue = &l;
+                }
+            }
+
+            lane *chosen = overdue ? overdue : urgent;
+            if (!chosen) {
+                return false;
+            }
+
+            pending p = std::move(chosen->queue.front());
+            chosen->queue.pop_front();
+
+            auto wait = now - p.queued;
+            chosen->stats.served++;
+            chosen->stats.total_wait += wait;
+            chosen->stats.max_wait = std::max(chosen->stats.max_wait, wait);
+            if (p.deadline <= now) {
+                chosen->stats.late++;
+            }
+
+            std::visit([this](auto &&x){ inner.emit(std::move(x)); }, std::move(p.element));
+            return true;
+        }
+
+        /**
+         * Serve queued elements until every lane is empty, including any queued by the attached flows while draining.
+         * @return the number of elements served
+         */
+        size_t drain() {
+            size_t n = 0;
+            while (step()) {
+                n++;
+            }
+            return n;
+        }
+
+        [[nodiscard]] size_t pending_count(size_t l) const {
+            return lanes.at(l).queue.size();
+        }
+
+        [[nodiscard]] const lane_stats &stats(size_t l) const {
+            return lanes.at(l).stats;
+        }
+
+        template <attractor_type ...A> priority_flux<X...> &attach(flow<A...> flow, removal_tag_t *remove_tag = nullptr) {
+            inner.attach(std::move(flow), remove_tag);
+            return *this;
+        }
+
+        template <attractor_type A> priority_flux<X...> &attach(A attractor, removal_tag_t *remove_tag = nullptr) {
+            inner.attach(std::move(attractor), remove_tag);
+            return *this;
+        }
+
+        template <attractor_type ...A> priority_flux<X...> &except(flow<A...> flow, removal_tag_t *remove_tag = nullptr) {
+            inner.except(std::move(flow), remove_tag);
+            return *this;
+        }
+
+        template <attractor_type A> priority_flux<X...> &except(A attractor, removal_tag_t *remove_tag = nullptr) {
+            inner.except(std::move(attractor), remove_tag);
+            return *this;
+        }
+
+        priority_flux<X...> &detach(removal_tag_t &remove_tag) {
+            inner.detach(remove_tag);
+            return *this;
+        }
+
+        priority_flux<X...> &detach_except(removal_tag_t &remove_tag) {
+            inner.detach_except(remove_tag);
+            return *this;
+        }
+
+        /**
+         * Checkpoint the attached flows. Elements still queued in the lanes are not recorded.
+         */
+        const priority_flux<X...> &snapshot(checkpoint_sink &sink) const {
+            inner.snapshot(sink);
+            return *this;
+        }
+
+        priority_flux<X...> &restore(checkpoint_source &source) {
+            inner.restore(source);
+            return *this;
+        }
+    };
+}
+
+#endif //ALEMBIC_PRIORITY_FLUX_H
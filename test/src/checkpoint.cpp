@@ -0,0 +1,231 @@
+/*
+ * Copyright 2021 Kioshi Morosin <hex@hex.lc>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <filesystem>
+#include <gtest/gtest.h>
+#include <alembic/flux.h>
+#include <alembic/checkpoint_file.h>
+
+struct running_total {
+    int acc = 0;
+
+    std::optional<int> operator()(int i) {
+        acc += i;
+        if (acc > 6) {
+            return acc;
+        }
+        return { };
+    }
+
+    void snapshot(alembic::checkpoint_sink &sink) const {
+        sink.write(acc);
+    }
+
+    void restore(alembic::checkpoint_source &source) {
+        source.read(acc);
+    }
+};
+
+/**
+ * Counts elements without checkpoint members of its own; it opts in through `attractor_traits` instead.
+ */
+struct counter {
+    static constexpr auto attractor_name = "counter";
+
+    int count = 0;
+
+    template <size_t I, class F, class X> void emit(X &&x, const F *flow) {
+        count++;
+        alembic::try_emit<I+1>(count, flow);
+    }
+};
+
+template <> struct alembic::attractor_traits<counter> {
+    static void snapshot(const counter &c, checkpoint_sink &sink) {
+        sink.write(c.count);
+    }
+
+    static void restore(counter &c, checkpoint_source &source) {
+        source.read(c.count);
+    }
+};
+
+TEST(checkpoint, ConceptCheck) {
+    static_assert(alembic::stateful_attractor<alembic::collect_n<int, 3>>);
+    static_assert(alembic::stateful_attractor<alembic::reduce<running_total>>);
+    static_assert(!alembic::stateful_attractor<alembic::collect_n<std::string, 3>>);
+    static_assert(!alembic::stateful_attractor<alembic::collect_n<const char *, 3>>);
+    static_assert(!alembic::stateful_attractor<alembic::reduce<decltype([](int i){ return std::optional<int>(i); })>>);
+    static_assert(!alembic::stateful_attractor<alembic::flat>);
+    static_assert(alembic::stateful_attractor<counter>);
+}
+
+TEST(checkpoint, FlowRoundTrip) {
+    alembic::collect_n<int, 3> c;
+    c.values = { 4, 5, 0 };
+    c.i = 2;
+    auto f = alembic::flow(c) >> alembic::flat { };
+
+    alembic::checkpoint_sink sink;
+    f.snapshot(sink);
+
+    auto g = alembic::collect_n<int, 3>() >> alembic::flat { };
+    alembic::checkpoint_source source(sink.data());
+    auto h = g.restored(source);
+
+    EXPECT_TRUE(source.exhausted());
+    EXPECT_EQ(g.attractor<0>().i, 0);
+    EXPECT_EQ(h.attractor<0>().i, 2);
+    EXPECT_EQ(h.attractor<0>().values[1], 5);
+}
+
+TEST(checkpoint, FluxWarmRestart) {
+    auto path = (std::filesystem::temp_directory_path() / "alembic_checkpoint_test").string();
+    std::array<int, 3> out = { 0, 0, 0 };
+    int total = 0;
+
+    {
+        alembic::flux<int> f;
+        f.attach(alembic::collect_n<int, 3>() >> alembic::map { [&out](auto array){ out = array; } });
+        f.attach(alembic::reduce { running_total { } } >> alembic::map { [&total](int t){ total = t; } });
+        f.emit(-5);
+        f.emit(102);
+
+        alembic::checkpoint_sink sink;
+        f.snapshot(sink);
+        alembic::write_checkpoint(path, sink);
+    }
+
+    alembic::flux<int> f;
+    f.attach(alembic::collect_n<int, 3>() >> alembic::map { [&out](auto array){ out = array; } });
+    f.attach(alembic::reduce { running_total { } } >> alembic::map { [&total](int t){ total = t; } });
+    {
+        alembic::mapped_checkpoint checkpoint(path);
+        auto source = checkpoint.source();
+        f.restore(source);
+        EXPECT_TRUE(source.exhausted());
+    }
+    std::filesystem::remove(path);
+
+    f.emit(33);
+    EXPECT_EQ(out[0], -5);
+    EXPECT_EQ(out[1], 102);
+    EXPECT_EQ(out[2], 33);
+    EXPECT_EQ(total, 130);
+}
+
+TEST(checkpoint, FluxMismatch) {
+    alembic::flux<int> f;
+    f.attach(alembic::collect_n<int, 2>() >> alembic::flat { });
+
+    alembic::checkpoint_sink sink;
+    f.snapshot(sink);
+
+    alembic::flux<int> g;
+    alembic::checkpoint_source source(sink.data());
+    EXPECT_THROW(g.restore(source), alembic::checkpoint_error);
+}
+
+TEST(checkpoint, AttractorTraits) {
+    int seen = 0;
+    alembic::checkpoint_sink sink;
+    {
+        alembic::flux<int> f;
+        f.attach(counter { } >> alembic::map { [&seen](int n){ seen = n; } });
+        f.emit(1).emit(1).emit(1);
+        f.snapshot(sink);
+    }
+
+    alembic::flux<int> f;
+    f.attach(counter { } >> alembic::map { [&seen](int n){ seen = n; } });
+    alembic::checkpoint_source source(sink.data());
+    f.restore(source);
+    f.emit(1);
+    EXPECT_EQ(seen, 4);
+}
+
+TEST(checkpoint, FluxMismatchLeavesStateUnchanged) {
+    std::array<int, 2> out = { 0, 0 };
+    alembic::checkpoint_sink sink;
+    {
+        alembic::flux<int> f;
+        f.attach(alembic::collect_n<int, 2>() >> alembic::flat { });
+        f.attach(alembic::map { [](int i){ } });
+        f.emit(7);
+        f.snapshot(sink);
+    }
+
+    // same number of subflows, but the stateful one is now second
+    alembic::flux<int> f;
+    f.attach(alembic::collect_n<int, 2>() >> alembic::map { [&out](auto array){ out = array; } });
+    f.attach(alembic::collect_n<int, 2>() >> alembic::flat { });
+    f.emit(3);
+
+    alembic::checkpoint_source source(sink.data());
+    EXPECT_THROW(f.restore(source), alembic::checkpoint_error);
+
+    f.emit(4);
+    EXPECT_EQ(out[0], 3);
+    EXPECT_EQ(out[1], 4);
+}
+
+TEST(checkpoint, WriteReplacesPrevious) {
+    auto path = (std::filesystem::temp_directory_path() / "alembic_checkpoint_replace").string();
+    alembic::checkpoint_sink first;
+    first.write(1);
+    alembic::checkpoint_sink second;
+    second.write(2);
+
+    alembic::write_checkpoint(path, first);
+    alembic::write_checkpoint(path, second);
+    EXPECT_FALSE(std::filesystem::exists(path + ".tmp"));
+    {
+        alembic::mapped_checkpoint checkpoint(path);
+        auto source = checkpoint.source();
+        EXPECT_EQ(source.read<int>(), 2);
+        EXPECT_TRUE(source.exhausted());
+    }
+    std::filesystem::remove(path);
+}
+
+TEST(checkpoint, FingerprintMismatch) {
+    auto f = alembic::collect_n<int, 2>() >> alembic::flat { };
+    alembic::checkpoint_sink sink;
+    f.snapshot(sink);
+
+    auto g = alembic::collect_n<float, 2>() >> alembic::flat { };
+    alembic::checkpoint_source source(sink.data());
+    EXPECT_THROW(g.restored(source), alembic::checkpoint_error);
+}
+
+TEST(checkpoint, TrailingData) {
+    int seen = 0;
+    alembic::checkpoint_sink sink;
+    {
+        alembic::flux<int> f;
+        f.attach(counter { } >> alembic::map { [&seen](int n){ seen = n; } });
+        f.emit(1);
+        f.snapshot(sink);
+        sink.write(uint32_t(0));
+    }
+
+    alembic::flux<int> f;
+    f.attach(counter { } >> alembic::map { [&seen](int n){ seen = n; } });
+    alembic::checkpoint_source source(sink.data());
+    EXPECT_THROW(f.restore(source), alembic::checkpoint_error);
+    f.emit(1);
+    EXPECT_EQ(seen, 1);
+}
@@ -163,3 +163,17 @@ TEST(flux_test, Reduce) {
     f.emit(2);
     f.emit(7);
 }
+
+TEST(flux_test, CopyKeepsOwnState) {
+    alembic::flux<int> f;
+    bool fired = false;
+
+    f.attach(alembic::collect_n<int, 2>() >> alembic::map { [&fired](auto array){ fired = true; } });
+    auto g = f;
+    f.emit(1);
+    g.emit(2);
+    EXPECT_FALSE(fired);
+
+    f.emit(3);
+    EXPECT_TRUE(fired);
+}
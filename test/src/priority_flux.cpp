@@ -0,0 +1,143 @@
+/*
+ * Copyright 2021 Kioshi Morosin <hex@hex.lc>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+#include <alembic/priority_flux.h>
+
+using namespace std::chrono_literals;
+
+TEST(priority_flux, StrictPriority) {
+    alembic::priority_flux<int> f { 1h, 1h };
+    std::vector<int> out;
+
+    f.attach(alembic::map { [&out](int i){ out.push_back(i); } });
+    f.emit(1, 1).emit(2, 1).emit(3, 0);
+    EXPECT_TRUE(out.empty());
+    EXPECT_EQ(f.pending_count(1), 2);
+
+    EXPECT_EQ(f.drain(), 3);
+    EXPECT_EQ(out, (std::vector<int> { 3, 1, 2 }));
+    EXPECT_EQ(f.stats(0).served, 1);
+    EXPECT_EQ(f.stats(1).served, 2);
+    EXPECT_EQ(f.stats(1).late, 0);
+    EXPECT_FALSE(f.step());
+}
+
+TEST(priority_flux, OverdueLaneServedFirst) {
+    alembic::priority_flux<int> f { 1h, 0ns };
+    std::vector<int> out;
+
+    f.attach(alembic::map { [&out](int i){ out.push_back(i); } });
+    f.emit(1, 0).emit(2, 1).emit(3, 0);
+    f.drain();
+
+    EXPECT_EQ(out, (std::vector<int> { 2, 1, 3 }));
+    EXPECT_EQ(f.stats(1).late, 1);
+}
+
+TEST(priority_flux, PolytypeAndException) {
+    alembic::priority_flux<double, std::string> f { 1h, 1h };
+    double x = 0.;
+    std::string s;
+    bool caught = false;
+
+    f.attach(alembic::map { [&x](const double &d){
+        if (d < 0) {
+            throw std::runtime_error("negative");
+        }
+        x = d;
+        return d;
+    } } >> alembic::seek { } >> alembic::map { [&s](const std::string &str){ s = str; } })
+        .except(alembic::map { [&caught](auto ex){ caught = true; } });
+
+    f.emit(std::string("swordfish"), 1).emit(0.5, 0).emit(-1., 1);
+    f.drain();
+
+    EXPECT_DOUBLE_EQ(x, 0.5);
+    EXPECT_EQ(s, "swordfish");
+    EXPECT_TRUE(caught);
+    EXPECT_THROW(f.emit(1., 2), std::out_of_range);
+}
+
+TEST(priority_flux, ExplicitDeadline) {
+    alembic::priority_flux<int> f { 1h, 1h };
+    std::vector<int> out;
+
+    f.attach(alembic::map { [&out](int i){ out.push_back(i); } });
+    f.emit(1, 0).emit(2, 1, std::chrono::steady_clock::now() - 1s);
+    f.drain();
+
+    EXPECT_EQ(out, (std::vector<int> { 2, 1 }));
+    EXPECT_EQ(f.stats(1).late, 1);
+    EXPECT_EQ(f.stats(0).late, 0);
+    EXPECT_GT(f.stats(0).max_wait, 0ns);
+    EXPECT_GE(f.stats(0).total_wait, f.stats(0).max_wait);
+}
+
+TEST(priority_flux, MoveOnly) {
+    alembic::priority_flux<std::unique_ptr<int>> f { 1h };
+    int out = 0;
+
+    f.attach(alembic::map { [&out](std::unique_ptr<int> p){ out = *p; } });
+    f.emit(std::make_unique<int>(42));
+    f.drain();
+    EXPECT_EQ(out, 42);
+}
+
+TEST(priority_flux, DetachExcept) {
+    alembic::priority_flux<int> f { 1h };
+    alembic::removal_tag_t tag;
+    int caught = 0;
+
+    f.attach(alembic::map { [](int i) -> void { throw std::runtime_error("hello"); } })
+        .except(alembic::map { [&caught](auto ex){ caught++; } }, &tag);
+    f.emit(1).drain();
+    f.detach_except(tag);
+    f.emit(2).drain();
+    EXPECT_EQ(caught, 1);
+}
+
+TEST(priority_flux, Checkpoint) {
+    std::array<int, 2> out = { 0, 0 };
+    alembic::checkpoint_sink sink;
+    {
+        alembic::priority_flux<int> f { 1h };
+        f.attach(alembic::collect_n<int, 2>() >> alembic::flat { });
+        f.emit(8).drain();
+        f.snapshot(sink);
+    }
+
+    alembic::priority_flux<int> f { 1h };
+    f.attach(alembic::collect_n<int, 2>() >> alembic::map { [&out](auto array){ out = array; } });
+    alembic::checkpoint_source source(sink.data());
+    f.restore(source);
+    f.emit(9).drain();
+
+    EXPECT_EQ(out[0], 8);
+    EXPECT_EQ(out[1], 9);
+}
+
+TEST(priority_flux, UnboundedBudget) {
+    alembic::priority_flux<int> f { 1h, std::chrono::steady_clock::duration::max() };
+    std::vector<int> out;
+
+    f.attach(alembic::map { [&out](int i){ out.push_back(i); } });
+    f.emit(1, 1).emit(2, 0);
+    f.drain();
+
+    EXPECT_EQ(out, (std::vector<int> { 2, 1 }));
+    EXPECT_EQ(f.stats(1).late, 0);
+}